@@ -0,0 +1,77 @@
+#!/bin/bash
+
+# Test script for binary snapshots and restarts
+# Usage: ./test_snapshot_restart.sh   (after building BARNES)
+#
+# input.zeromass holds 16 bodies, the first of which has zero mass and
+# so is never put in the tree.  A run from it writes a snapshot every
+# step; a second run restarts from the second snapshot, and a third
+# run does the first again with 4 processes.  The restarted run must
+# reproduce the later snapshots bit for bit, and every snapshot must
+# hold the input mass, position and velocity of the zero-mass body,
+# which never moves.
+
+cd "$(dirname "$0")"
+
+if [ ! -x ./BARNES ]; then
+    echo "BARNES is not built"
+    exit 1
+fi
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+NBODY=16
+FAILED=0
+
+# in, out, dtime, eps, tol, fcells, fleaves, tstop, dtout, NPROC, morton
+params() {
+    printf '%s\n%s\n0.025\n0.05\n1.0\n2.0\n0.5\n0.1\n0.025\n%s\n1\n' \
+        "$1" "$2" "${3:-1}"
+}
+
+# value of column $2 for body 0 of snapshot $1, as the input file prints it
+column0() {
+    local header=$(( $(stat -c %s "$1") - 12 * NBODY * 8 ))
+    printf '%.6f' $(od -A n -t f8 -j $(( header + $2 * NBODY * 8 )) -N 8 "$1")
+}
+
+params input.zeromass "$DIR/a" | ./BARNES > "$DIR/a.log" 2>&1 || {
+    echo "FAILED: the run from input.zeromass exited with $?"
+    exit 1
+}
+params "$DIR/a.1" "$DIR/b" | ./BARNES > "$DIR/b.log" 2>&1 || {
+    echo "FAILED: the restart from $DIR/a.1 exited with $?"
+    exit 1
+}
+params input.zeromass "$DIR/c" 4 | ./BARNES > "$DIR/c.log" 2>&1 || {
+    echo "FAILED: the 4-process run from input.zeromass exited with $?"
+    exit 1
+}
+
+for i in 0 1; do
+    if ! cmp -s "$DIR/b.$i" "$DIR/a.$((i + 2))"; then
+        echo "FAILED: restarted snapshot $i differs from snapshot $((i + 2))"
+        FAILED=1
+    fi
+done
+
+# mass, then the position and velocity lines of body 0 in input.zeromass
+EXPECTED=("0.000000"
+          $(sed -n "$((NBODY + 4))p" input.zeromass)
+          $(sed -n "$((2 * NBODY + 4))p" input.zeromass))
+for f in "$DIR"/a.* "$DIR"/b.* "$DIR"/c.*; do
+    case "$f" in *.log) continue ;; esac
+    for c in 0 1 2 3 4 5 6; do
+        v=$(column0 "$f" $c)
+        if [ "$v" != "${EXPECTED[$c]}" ]; then
+            echo "FAILED: column $c of the zero-mass body in $(basename "$f")" \
+                 "is $v, not ${EXPECTED[$c]}"
+            FAILED=1
+        fi
+    done
+done
+
+if [ $FAILED -eq 0 ]; then
+    echo "Snapshot restart test passed"
+fi
+exit $FAILED
@@ -3,58 +3,175 @@
 #include <stdarg.h>
 #include <time.h>
 #include <math.h>
-#include <ctype.h>
+#include <sched.h>
 
 // DMTCP support
 #ifdef DMTCP
 #include "dmtcp.h"
 #endif
 
+#define WAIT_TIMEOUT_MS 5000   // Longest wait for the other instances
+#define CONNECT_ATTEMPTS 50    // Tries (100ms apart) to find the segment
+
 // Global validation state
 validation_context_t *g_validation_context = NULL;
 cross_validation_t *g_validation = NULL;
 int g_validation_enabled = 0;
 int g_instance_id = 0;
-char g_socket_path[256];
-int g_client_fds[16];
-int g_sync_point_counter = 0;  // Sequential counter for unique sync points
+long g_sync_point_counter = 0;  // Sequential counter for unique sync points
+
+// Per-instance progress and rings, inside the segment
+static instance_state_t *g_states = NULL;
+static fingerprint_t *g_rings = NULL;
 
 // DMTCP checkpoint state
 static int saved_instance_id = -1;
 static int saved_num_instances = -1;
 static volatile int checkpoint_in_progress = 0;
 
-// Coordinator state
-typedef struct {
-    int current_sync_point;
-    int instances_arrived;
-    char fingerprints[MAX_INSTANCES][MAX_FINGERPRINT_LEN];
-    int instance_ids[MAX_INSTANCES];
-    int validation_failed;
-    char mismatch_details[512];
-    int num_instances;
-} coordinator_state_t;
+// Forward declaration for DMTCP functions
+static void close_validation_memory(void);
 
-static coordinator_state_t g_coordinator_state = {0};
+static int env_int(const char *name, int def) {
+    const char *value = getenv(name);
+    return value ? atoi(value) : def;
+}
 
-// Forward declaration for DMTCP functions
-static void close_validation_sockets(void);
+static size_t validation_size(int num_instances, int ring_slots) {
+    return sizeof(cross_validation_t)
+         + (size_t)num_instances * sizeof(instance_state_t)
+         + (size_t)num_instances * (size_t)ring_slots * sizeof(fingerprint_t);
+}
+
+static void map_layout(void) {
+    char *base = (char*)g_validation + sizeof(cross_validation_t);
+    g_states = (instance_state_t*)base;
+    g_rings = (fingerprint_t*)(base + (size_t)g_validation->num_instances * sizeof(instance_state_t));
+}
+
+static fingerprint_t *ring_slot(int instance, long seq) {
+    return &g_rings[(size_t)instance * g_validation->ring_slots + seq % g_validation->ring_slots];
+}
+
+static long load_long(volatile long *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static int load_int(volatile int *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static long elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+// Create (coordinator) or map (other instances) the shared memory segment
+static int map_validation_memory(int instance_id, int num_instances) {
+    validation_context_t *ctx = g_validation_context;
+
+    if (ctx->is_coordinator) {
+        int ring_slots = env_int("CROSS_VALIDATION_MAX_SYNC_POINTS", MAX_SYNC_POINTS);
+        int batch = env_int("CROSS_VALIDATION_BATCH", SYNC_BATCH);
+        if (batch < 1) batch = 1;
+        // An instance may run a whole batch ahead of the slowest checker
+        if (ring_slots < 2 * batch) ring_slots = 2 * batch;
+
+        shm_unlink(SHM_NAME);
+        ctx->shm_fd = shm_open(SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (ctx->shm_fd < 0) {
+            perror("Failed to create validation shared memory");
+            return -1;
+        }
+        ctx->shm_size = validation_size(num_instances, ring_slots);
+        if (ftruncate(ctx->shm_fd, (off_t)ctx->shm_size) < 0) {
+            perror("Failed to size validation shared memory");
+            return -1;
+        }
+        g_validation = (cross_validation_t*)mmap(NULL, ctx->shm_size, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED, ctx->shm_fd, 0);
+        if (g_validation == MAP_FAILED) {
+            perror("Failed to map validation shared memory");
+            g_validation = NULL;
+            return -1;
+        }
+        g_validation->num_instances = num_instances;
+        g_validation->ring_slots = ring_slots;
+        g_validation->batch = batch;
+        g_validation->attached = 1;
+        map_layout();
+        __atomic_store_n(&g_validation->magic, VALIDATION_MAGIC, __ATOMIC_RELEASE);
+        printf("🎯 Coordinator created %s: %d instances, %d-slot rings, blocking every %d sync points\n",
+               SHM_NAME, num_instances, ring_slots, batch);
+        fflush(stdout);
+        return 0;
+    }
+
+    // Wait for the coordinator's segment; one left by a crashed run is
+    // already fully attached and gets replaced by the coordinator
+    for (int attempt = 0; attempt < CONNECT_ATTEMPTS; attempt++, usleep(100000)) {
+        struct stat st;
+        cross_validation_t *header;
+
+        ctx->shm_fd = shm_open(SHM_NAME, O_RDWR, 0600);
+        if (ctx->shm_fd < 0) {
+            if (errno == ENOENT || errno == EINTR) continue;
+            perror("Failed to open validation shared memory");
+            return -1;
+        }
+        if (fstat(ctx->shm_fd, &st) < 0 || (size_t)st.st_size < sizeof(cross_validation_t)) {
+            close(ctx->shm_fd);
+            continue;
+        }
+        header = (cross_validation_t*)mmap(NULL, sizeof(cross_validation_t), PROT_READ,
+                                           MAP_SHARED, ctx->shm_fd, 0);
+        if (header == MAP_FAILED) {
+            close(ctx->shm_fd);
+            continue;
+        }
+        if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != VALIDATION_MAGIC ||
+            header->num_instances != num_instances ||
+            load_int(&header->attached) >= num_instances) {
+            munmap(header, sizeof(cross_validation_t));
+            close(ctx->shm_fd);
+            continue;
+        }
+        ctx->shm_size = validation_size(num_instances, header->ring_slots);
+        munmap(header, sizeof(cross_validation_t));
+
+        g_validation = (cross_validation_t*)mmap(NULL, ctx->shm_size, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED, ctx->shm_fd, 0);
+        if (g_validation == MAP_FAILED) {
+            perror("Failed to map validation shared memory");
+            g_validation = NULL;
+            close(ctx->shm_fd);
+            return -1;
+        }
+        map_layout();
+        __atomic_add_fetch(&g_validation->attached, 1, __ATOMIC_ACQ_REL);
+        return 0;
+    }
+
+    fprintf(stderr, "❌ Instance %d found no validation shared memory %s (timeout)\n", instance_id, SHM_NAME);
+    return -1;
+}
 
 int init_cross_validation(int instance_id, int num_instances) {
-    if (num_instances > MAX_INSTANCES) {
-        fprintf(stderr, "❌ Too many instances: %d (max: %d)\n", num_instances, MAX_INSTANCES);
+    static int registered_exit = 0;
+    int max_instances = env_int("CROSS_VALIDATION_MAX_INSTANCES", MAX_INSTANCES);
+
+    if (num_instances > max_instances) {
+        fprintf(stderr, "❌ Too many instances: %d (max: %d)\n", num_instances, max_instances);
+        return -1;
+    }
+    if (num_instances < 1 || instance_id < 0 || instance_id >= num_instances) {
+        fprintf(stderr, "❌ Bad instance %d of %d\n", instance_id, num_instances);
         return -1;
     }
     
     g_instance_id = instance_id;
 
-    // Create shared socket path that works across McMini instances
-    // Use a fixed path that both instances can access
-    snprintf(g_socket_path, sizeof(g_socket_path), "/tmp/water_validation_shared");
-    
-    printf("🔧 Instance %d using shared socket path: %s\n", instance_id, g_socket_path);
-    fflush(stdout);
-    
     // Allocate validation context
     g_validation_context = (validation_context_t*)calloc(1, sizeof(validation_context_t));
     if (!g_validation_context) {
@@ -65,679 +182,264 @@ int init_cross_validation(int instance_id, int num_instances) {
     g_validation_context->instance_id = instance_id;
     g_validation_context->num_instances = num_instances;
     g_validation_context->is_coordinator = (instance_id == 0);
+    g_validation_context->shm_fd = -1;
 
-    // If this is the coordinator (instance 0), set up Unix domain socket server
-    if (g_validation_context->is_coordinator) {
-        unlink(g_socket_path);
-        g_validation_context->server_socket = socket(AF_UNIX, SOCK_STREAM, 0);
-        if (g_validation_context->server_socket < 0) {
-            perror("Failed to create Unix domain socket");
-            free(g_validation_context);
-            return -1;
-        }
-        // Set non-blocking
-        int flags = fcntl(g_validation_context->server_socket, F_GETFL, 0);
-        fcntl(g_validation_context->server_socket, F_SETFL, flags | O_NONBLOCK);
-
-        struct sockaddr_un server_addr;
-        memset(&server_addr, 0, sizeof(server_addr));
-        server_addr.sun_family = AF_UNIX;
-        strncpy(server_addr.sun_path, g_socket_path, sizeof(server_addr.sun_path) - 1);
-        if (bind(g_validation_context->server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            perror("Failed to bind Unix domain socket");
-            close(g_validation_context->server_socket);
-            free(g_validation_context);
-            return -1;
-        }
-        if (listen(g_validation_context->server_socket, MAX_INSTANCES) < 0) {
-            perror("Failed to listen on Unix domain socket");
-            close(g_validation_context->server_socket);
-            free(g_validation_context);
-            return -1;
-        }
-        printf("🎯 Unix socket coordinator ready, bound and listening on %s\n", g_socket_path);
-        fflush(stdout);
-        g_coordinator_state.current_sync_point = -1;
-        g_coordinator_state.instances_arrived = 0;
-        g_coordinator_state.validation_failed = 0;
-        g_coordinator_state.num_instances = num_instances;
-        if (pthread_create(&g_validation_context->coordinator_thread, NULL, coordinator_thread_func, g_validation_context) != 0) {
-            perror("Failed to create coordinator thread");
-            close(g_validation_context->server_socket);
-            free(g_validation_context);
-            return -1;
-        }
-        printf("🔍 Cross-validation coordinator started with Unix socket %s for %d instances\n", g_socket_path, num_instances);
-        fflush(stdout);
-    }
-    usleep(200000);
-    g_validation_context->client_socket = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (g_validation_context->client_socket < 0) {
-        perror("Failed to create client Unix socket");
-        cleanup_cross_validation();
-        return -1;
-    }
-    // Set non-blocking
-    int cflags = fcntl(g_validation_context->client_socket, F_GETFL, 0);
-    fcntl(g_validation_context->client_socket, F_SETFL, cflags | O_NONBLOCK);
-    struct sockaddr_un coord_addr;
-    memset(&coord_addr, 0, sizeof(coord_addr));
-    coord_addr.sun_family = AF_UNIX;
-    strncpy(coord_addr.sun_path, g_socket_path, sizeof(coord_addr.sun_path) - 1);
-    int connect_attempts = 0;
-    while (connect(g_validation_context->client_socket, (struct sockaddr*)&coord_addr, sizeof(coord_addr)) < 0) {
-        if (errno == EINPROGRESS || errno == EALREADY || errno == EINTR || errno == EAGAIN || errno == ENOENT) {
-            usleep(100000);
-            if (++connect_attempts > 50) {
-                perror("Failed to connect to coordinator Unix socket (timeout)");
-                cleanup_cross_validation();
-                return -1;
-            }
-            continue;
-        }
-        perror("Failed to connect to coordinator Unix socket");
-        cleanup_cross_validation();
+    if (map_validation_memory(instance_id, num_instances) < 0) {
+        close_validation_memory();
+        free(g_validation_context);
+        g_validation_context = NULL;
         return -1;
     }
-    // Set back to blocking after connect
-    fcntl(g_validation_context->client_socket, F_SETFL, cflags & ~O_NONBLOCK);
-    validation_message_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.type = MSG_REGISTER_INSTANCE;
-    msg.instance_id = instance_id;
-    if (send_validation_message(&msg) < 0) {
-        fprintf(stderr, "Failed to register instance %d\n", instance_id);
-        cleanup_cross_validation();
-        return -1;
+
+    // Compare the sync points of the last, unfinished batch on exit
+    if (!registered_exit) {
+        atexit(cleanup_cross_validation);
+        registered_exit = 1;
     }
+
     g_validation_enabled = 1;
-    printf("✅ Instance %d connected to Unix socket-based cross-validation system\n", instance_id);
+    printf("✅ Instance %d attached to shared-memory cross-validation %s\n", instance_id, SHM_NAME);
     fflush(stdout);
     return 0;
 }
 
-static void close_validation_sockets(void) {
+static void close_validation_memory(void) {
     if (!g_validation_context) return;
     
     checkpoint_in_progress = 1;
-    
-    // Stop coordinator thread if running
-    if (g_validation_context->is_coordinator && g_validation_context->coordinator_thread) {
-        pthread_cancel(g_validation_context->coordinator_thread);
-        pthread_join(g_validation_context->coordinator_thread, NULL);
-        g_validation_context->coordinator_thread = 0;
+
+    // The last instance to detach removes the segment
+    if (g_validation) {
+        int remove = __atomic_sub_fetch(&g_validation->attached, 1, __ATOMIC_ACQ_REL) <= 0;
+        munmap(g_validation, g_validation_context->shm_size);
+        g_validation = NULL;
+        g_states = NULL;
+        g_rings = NULL;
+        if (remove) {
+            shm_unlink(SHM_NAME);
+        }
     }
     
-    // Close all sockets
-    if (g_validation_context->client_socket >= 0) {
-        close(g_validation_context->client_socket);
-        g_validation_context->client_socket = -1;
+    if (g_validation_context->shm_fd >= 0) {
+        close(g_validation_context->shm_fd);
+        g_validation_context->shm_fd = -1;
     }
-    
-    if (g_validation_context->server_socket >= 0) {
-        close(g_validation_context->server_socket);
-        g_validation_context->server_socket = -1;
+}
+
+void generate_fingerprint(fingerprint_t *fp, sync_point_t sync_point, const double *values, int count) {
+    if (count > MAX_FINGERPRINT_VALUES) {
+        count = MAX_FINGERPRINT_VALUES;
     }
-    
-    // Close all client fds in coordinator
-    for (int i = 0; i < MAX_INSTANCES; i++) {
-        if (g_client_fds[i] >= 0) {
-            close(g_client_fds[i]);
-            g_client_fds[i] = -1;
-        }
+    fp->sync_point = (int)sync_point;
+    fp->count = count;
+    memcpy(fp->values, values, (size_t)count * sizeof(double));
+}
+
+// Function to compare fingerprints with floating-point tolerance
+int compare_fingerprints_with_tolerance(const fingerprint_t *fp1, const fingerprint_t *fp2) {
+    if (fp1->sync_point != fp2->sync_point || fp1->count != fp2->count) {
+        return 0;
     }
-    
-    // Remove socket file
-    if (g_validation_context->is_coordinator) {
-        unlink(g_socket_path);
+    for (int i = 0; i < fp1->count; i++) {
+        // Written so that a NaN on either side is a mismatch
+        if (!(fabs(fp1->values[i] - fp2->values[i]) <= FLOAT_TOLERANCE) &&
+            memcmp(&fp1->values[i], &fp2->values[i], sizeof(double)) != 0) {
+            return 0;
+        }
     }
+    return 1;
 }
 
-void cleanup_cross_validation() {
-    if (!g_validation_enabled || !g_validation_context) return;
-
-    // Send shutdown message if socket is still open
-    if (g_validation_context->client_socket >= 0) {
-        validation_message_t msg;
-        memset(&msg, 0, sizeof(msg));
-        msg.type = MSG_SHUTDOWN;
-        msg.instance_id = g_instance_id;
-        send_validation_message(&msg);
+static int format_fingerprint(char *buffer, size_t size, const fingerprint_t *fp) {
+    int n = snprintf(buffer, size, "[%d]", fp->sync_point);
+    for (int i = 0; i < fp->count && n > 0 && (size_t)n < size; i++) {
+        n += snprintf(buffer + n, size - (size_t)n, " %.15f", fp->values[i]);
     }
+    return n;
+}
 
-    close_validation_sockets();
+// Publish a mismatch to all instances and assert
+static void validation_mismatch(int other, long seq, const char *reason) {
+    char local[200], remote[200];
+    int first = __atomic_exchange_n(&g_validation->validation_failed, 1, __ATOMIC_ACQ_REL) == 0;
 
-    free(g_validation_context);
-    g_validation_context = NULL;
+    if (reason) {
+        snprintf(g_validation->mismatch_details, sizeof(g_validation->mismatch_details),
+                 "Sync point %ld: %s", seq, reason);
+    } else {
+        format_fingerprint(local, sizeof(local), ring_slot(g_instance_id, seq));
+        format_fingerprint(remote, sizeof(remote), ring_slot(other, seq));
+        if (first) {
+            snprintf(g_validation->mismatch_details, sizeof(g_validation->mismatch_details),
+                     "Sync point %ld: Instance %d='%s' vs Instance %d='%s'",
+                     seq, g_instance_id, local, other, remote);
+        }
+    }
 
-    g_validation_enabled = 0;
-    printf("🧹 Instance %d cleaned up Unix socket-based cross-validation\n", g_instance_id);
+    printf("❌ SYNCHRONIZED MISMATCH at sync point %ld: %s\n", seq, g_validation->mismatch_details);
     fflush(stdout);
+    fprintf(stderr, "\n🚨 ASSERTION FAILED: Synchronized cross-validation failed!\n");
+    fprintf(stderr, "🔍 Details: %s\n", g_validation->mismatch_details);
+    fprintf(stderr, "💥 Instance %d terminating due to validation mismatch.\n\n", g_instance_id);
+    fflush(stderr);
+    shm_unlink(SHM_NAME);
+    assert(0 && "Synchronized cross-validation fingerprint mismatch detected");
 }
 
-void generate_fingerprint(char *buffer, size_t buffer_size, const char *format, ...) {
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buffer, buffer_size, format, args);
-    va_end(args);
-}
+// Compare this instance's sync points against those every other instance
+// has published since the last call.  Each instance checks its own ring,
+// so a published fingerprint is read by all the others.
+static void compare_published(void) {
+    int me = g_instance_id;
+    long mine = g_states[me].published;
+    long upto = mine;
 
-void cross_validate_sync_point(sync_point_t sync_point, const char *fingerprint) {
-    if (!g_validation_enabled || !g_validation_context) {
-        return;
-    }
-    
-    // Skip validation if checkpoint is in progress
-    if (checkpoint_in_progress) {
-        printf("[CV-DEBUG] Skipping validation during checkpoint\n");
-        return;
-    }
-    
-    int unique_sync_point = ++g_sync_point_counter;
-    printf("🔧 Instance %d sending sync point %d: %s\n", g_instance_id, unique_sync_point, fingerprint);
-    fflush(stdout);
-    
-    validation_message_t msg;
-    msg.type = MSG_SYNC_POINT;
-    msg.instance_id = g_instance_id;
-    msg.sync_point = unique_sync_point;
-    strncpy(msg.fingerprint, fingerprint, MAX_FINGERPRINT_LEN - 1);
-    msg.fingerprint[MAX_FINGERPRINT_LEN - 1] = '\0';
-    
-    // Send with proper EINTR handling
-    size_t total_sent = 0;
-    char *buffer = (char*)&msg;
-    while (total_sent < sizeof(msg)) {
-        ssize_t sent = send(g_validation_context->client_socket, 
-                           buffer + total_sent, 
-                           sizeof(msg) - total_sent, 
-                           MSG_NOSIGNAL);
-        
-        if (sent > 0) {
-            total_sent += sent;
-        } else if (sent < 0) {
-            if (errno == EINTR) {
-                continue;  // Retry immediately on interrupt
-            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Socket buffer full, wait a bit
-                usleep(10000);
-                continue;
-            } else {
-                printf("❌ Instance %d failed to send sync point message: %s\n", 
-                       g_instance_id, strerror(errno));
-                return;
-            }
-        }
-    }
-    
-    // Receive response with timeout using select
-    validation_message_t response;
-    fd_set readfds;
-    struct timeval tv;
-    int max_wait_ms = 5000;  // 5 second total timeout
-    int elapsed_ms = 0;
-    
-    size_t total_received = 0;
-    char *recv_buffer = (char*)&response;
-    
-    while (total_received < sizeof(response) && elapsed_ms < max_wait_ms) {
-        FD_ZERO(&readfds);
-        FD_SET(g_validation_context->client_socket, &readfds);
-        
-        tv.tv_sec = 0;
-        tv.tv_usec = 100000;  // 100ms per select
-        
-        int ret = select(g_validation_context->client_socket + 1, &readfds, NULL, NULL, &tv);
-        
-        if (ret < 0) {
-            if (errno == EINTR) {
-                continue;  // Retry on interrupt
-            }
-            printf("❌ Instance %d select failed: %s\n", g_instance_id, strerror(errno));
-            return;
-        }
-        
-        if (ret == 0) {
-            // Timeout - no data yet
-            elapsed_ms += 100;
-            continue;
-        }
-        
-        // Data available, try to receive
-        ssize_t received = recv(g_validation_context->client_socket,
-                               recv_buffer + total_received,
-                               sizeof(response) - total_received,
-                               MSG_DONTWAIT);
-        
-        if (received > 0) {
-            total_received += received;
-        } else if (received < 0) {
-            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
-                elapsed_ms += 100;
-                continue;
-            }
-            printf("❌ Instance %d failed to receive validation result: %s\n", 
-                   g_instance_id, strerror(errno));
-            return;
-        } else {
-            // Connection closed
-            printf("❌ Instance %d connection closed while waiting for validation\n", g_instance_id);
+    for (int j = 0; j < g_validation->num_instances; j++) {
+        if (j == me) continue;
+        int done = load_int(&g_states[j].done);
+        long theirs = load_long(&g_states[j].published);
+        if (done && theirs < mine) {
+            char reason[128];
+            snprintf(reason, sizeof(reason), "instance %d stopped after %ld sync points, instance %d did not",
+                     j, theirs, me);
+            validation_mismatch(j, theirs + 1, reason);
             return;
         }
+        if (theirs < upto) upto = theirs;
     }
-    
-    if (total_received < sizeof(response)) {
-        printf("⚠️ Instance %d timeout waiting for validation response\n", g_instance_id);
-        return;
-    }
-    
-    // Process response as before
-    if (response.type == MSG_VALIDATION_RESULT) {
-        if (response.validation_passed) {
-            printf("✅ SYNCHRONIZED MATCH at sync point %d: %s\n", unique_sync_point, fingerprint);
-            fflush(stdout);
-        } else {
-            const char* other_fingerprint = response.mismatch_details;
-            printf("❌ CLIENT MISMATCH DETECTED at sync point %d\n", unique_sync_point);
-            printf("🔍 Local fingerprint: %s\n", fingerprint);
-            printf("🔍 Other fingerprint: %s\n", other_fingerprint);
-            fflush(stdout);
-            fprintf(stderr, "🚨 CLIENT ASSERTION FAILED: Synchronized cross-validation failed!\n");
-            fprintf(stderr, "Instance %d at sync point %d:\n", g_instance_id, unique_sync_point);
-            fprintf(stderr, "  Local:  %s\n", fingerprint);
-            fprintf(stderr, "  Other:  %s\n", other_fingerprint);
-            fprintf(stderr, "💥 Client terminating due to validation mismatch.\n");
-            fflush(stderr);
-            assert(0 && "Client: Synchronized cross-validation fingerprint mismatch detected");
-        }
-    }
-}
 
-// Function to compare fingerprints with floating-point tolerance
-int compare_fingerprints_with_tolerance(const char *fp1, const char *fp2) {
-    char *fp1_copy = strdup(fp1);
-    char *fp2_copy = strdup(fp2);
-    
-    if (!fp1_copy || !fp2_copy) {
-        free(fp1_copy);
-        free(fp2_copy);
-        return strcmp(fp1, fp2) == 0;  // Fallback to exact comparison
-    }
-    
-    char *token1, *token2;
-    char *saveptr1, *saveptr2;
-    int match = 1;
-    
-    // Tokenize both strings by spaces and = signs
-    token1 = strtok_r(fp1_copy, " =", &saveptr1);
-    token2 = strtok_r(fp2_copy, " =", &saveptr2);
-    
-    while (token1 && token2 && match) {
-        // Check if both tokens are numeric (floating-point)
-        char *endptr1, *endptr2;
-        double val1 = strtod(token1, &endptr1);
-        double val2 = strtod(token2, &endptr2);
-        
-        // If both are valid numbers, compare with tolerance
-        if (*endptr1 == '\0' && *endptr2 == '\0') {
-            if (fabs(val1 - val2) > FLOAT_TOLERANCE) {
-                match = 0;
-                break;
-            }
-        } else {
-            // For non-numeric tokens, use exact string comparison
-            if (strcmp(token1, token2) != 0) {
-                match = 0;
-                break;
+    for (long seq = g_states[me].checked + 1; seq <= upto; seq++) {
+        for (int j = 0; j < g_validation->num_instances; j++) {
+            if (j != me && !compare_fingerprints_with_tolerance(ring_slot(me, seq), ring_slot(j, seq))) {
+                validation_mismatch(j, seq, NULL);
+                return;
             }
         }
-        
-        token1 = strtok_r(NULL, " =", &saveptr1);
-        token2 = strtok_r(NULL, " =", &saveptr2);
     }
-    
-    // Check if both reached end simultaneously
-    if (token1 || token2) {
-        match = 0;
+    if (upto > g_states[me].checked) {
+        __atomic_store_n(&g_states[me].checked, upto, __ATOMIC_RELEASE);
     }
-    
-    free(fp1_copy);
-    free(fp2_copy);
-    return match;
 }
 
-// Socket communication functions
-int send_validation_message(validation_message_t *msg) {
-    if (!g_validation_context || g_validation_context->client_socket < 0) {
-        return -1;
-    }
-    
-    size_t total_sent = 0;
-    char *buffer = (char*)msg;
-    size_t remaining = sizeof(*msg);
-    
-    while (remaining > 0) {
-        ssize_t bytes_sent = send(g_validation_context->client_socket, 
-                                  buffer + total_sent, 
-                                  remaining, 
-                                  MSG_NOSIGNAL);
-        if (bytes_sent > 0) {
-            total_sent += bytes_sent;
-            remaining -= bytes_sent;
-        } else if (bytes_sent < 0) {
-            if (errno == EINTR) {
-                continue;
-            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(10000);
-                continue;
-            }
-            perror("Failed to send validation message");
-            return -1;
+// Every other instance has published sync point seq (or finished)
+static int all_published(long seq) {
+    for (int j = 0; j < g_validation->num_instances; j++) {
+        if (j != g_instance_id && load_long(&g_states[j].published) < seq && !load_int(&g_states[j].done)) {
+            return 0;
         }
     }
-    return 0;
+    return 1;
 }
 
-int receive_validation_message(int client_socket, validation_message_t *msg) {
-    size_t total_received = 0;
-    char *buffer = (char*)msg;
-    size_t remaining = sizeof(*msg);
-    
-    // Try to receive with non-blocking and handle partial messages
-    while (remaining > 0) {
-        ssize_t received = recv(client_socket, buffer + total_received, remaining, MSG_DONTWAIT);
-        
-        if (received > 0) {
-            total_received += received;
-            remaining -= received;
-        } else if (received == 0) {
-            // Connection closed
-            if (total_received > 0) {
-                // Partial message received before close
-                return -1;
-            }
-            return 0;  // Clean close
-        } else {
-            // Error occurred
-            if (errno == EINTR) {
-                // Interrupted by signal, retry
-                continue;
-            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // No data available right now
-                if (total_received == 0) {
-                    // Nothing received yet, return special code
-                    return -2;
-                }
-                // Partial message, wait a bit and retry
-                usleep(10000);
-                continue;
-            } else {
-                // Real error
-                perror("recv failed in receive_validation_message");
-                return -1;
-            }
+// Nobody needs the ring slot that sync point seq overwrites any more
+static int ring_slot_free(long seq) {
+    long reused = seq - g_validation->ring_slots;
+    for (int j = 0; j < g_validation->num_instances; j++) {
+        if (load_long(&g_states[j].checked) < reused && !load_int(&g_states[j].done)) {
+            return 0;
         }
     }
-    
-    return 1;  // Complete message received
+    return 1;
 }
 
-// Handle sync point messages from instances with assertion on mismatch
-void handle_sync_point_message(validation_message_t *msg) {
-    // Check if this is a new sync point
-    if (g_coordinator_state.current_sync_point != (int)msg->sync_point) {
-        // Reset for new sync point
-        g_coordinator_state.current_sync_point = (int)msg->sync_point;
-        g_coordinator_state.instances_arrived = 0;
-        memset(g_coordinator_state.fingerprints, 0, sizeof(g_coordinator_state.fingerprints));
-        memset(g_coordinator_state.instance_ids, -1, sizeof(g_coordinator_state.instance_ids));
-    }
-    
-    // Store this instance's fingerprint
-    int slot = g_coordinator_state.instances_arrived;
-    strncpy(g_coordinator_state.fingerprints[slot], msg->fingerprint, MAX_FINGERPRINT_LEN - 1);
-    g_coordinator_state.fingerprints[slot][MAX_FINGERPRINT_LEN - 1] = '\0';
-    g_coordinator_state.instance_ids[slot] = msg->instance_id;
-    g_coordinator_state.instances_arrived++;
-    
-    printf("📥 Coordinator received sync point %d from instance %d: %s (%d/%d)\n", 
-           (int)msg->sync_point, msg->instance_id, msg->fingerprint, 
-           g_coordinator_state.instances_arrived, g_coordinator_state.num_instances);
-    fflush(stdout);
+// Wait until cond(seq) holds, comparing what the other instances publish
+// meanwhile so that they are not held up by this instance in turn.
+// Returns 1 when it holds, 0 on a timeout and -1 on a mismatch.
+static int wait_for_instances(int (*cond)(long), long seq) {
+    struct timespec start;
+    int spins = 0;
 
-    // Don't send immediate ACK - wait for all instances to arrive for synchronized comparison
-    // This ensures both coordinator and client wait at sync point as required
-    
-    // Check if all instances have arrived for SYNCHRONIZED comparison
-    if (g_coordinator_state.instances_arrived == g_coordinator_state.num_instances) {
-        printf("🔄 All %d instances arrived for sync point %d - performing SYNCHRONIZED comparison...\n", 
-               g_coordinator_state.num_instances, (int)msg->sync_point);
-        
-        // Compare all fingerprints
-        int match = 1;
-        char mismatch_details[512];
-        
-        for (int i = 1; i < g_coordinator_state.num_instances; i++) {
-            if (!compare_fingerprints_with_tolerance(g_coordinator_state.fingerprints[0], g_coordinator_state.fingerprints[i])) {
-                match = 0;
-                snprintf(mismatch_details, sizeof(mismatch_details),
-                         "Sync point %d: Instance %d='%s' vs Instance %d='%s'",
-                         (int)msg->sync_point,
-                         g_coordinator_state.instance_ids[0], g_coordinator_state.fingerprints[0],
-                         g_coordinator_state.instance_ids[i], g_coordinator_state.fingerprints[i]);
-                break;
-            }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!cond(seq)) {
+        compare_published();
+        if (load_int(&g_validation->validation_failed)) {
+            return -1;
         }
-        
-        if (match) {
-            printf("✅ SYNCHRONIZED MATCH at sync point %d: %s\n", (int)msg->sync_point, g_coordinator_state.fingerprints[0]);
-            fflush(stdout);
-        } else {
-            printf("❌ SYNCHRONIZED MISMATCH at sync point %d: %s\n", (int)msg->sync_point, mismatch_details);
-            printf("🔍 COMPARISON DETAILS: %s\n", mismatch_details);
-            fflush(stdout);
-            
-            // Coordinator assertion on mismatch
-            fprintf(stderr, "\n🚨 COORDINATOR ASSERTION FAILED: Synchronized cross-validation failed!\n");
-            fprintf(stderr, "🔍 Details: %s\n", mismatch_details);
-            fprintf(stderr, "💥 Coordinator terminating due to validation mismatch.\n\n");
-            fflush(stderr);
-            assert(0 && "Coordinator: Synchronized cross-validation fingerprint mismatch detected");
+        if (++spins < 1000) {
+            sched_yield();
+            continue;
         }
-        
-        // Send comparison results to ALL instances so they can also compare and assert
-        for (int i = 0; i < g_coordinator_state.instances_arrived; i++) {
-            int instance_id = g_coordinator_state.instance_ids[i];
-            if (instance_id >= 0 && instance_id < MAX_INSTANCES) {
-                int client_fd = g_client_fds[instance_id];
-                if (client_fd > 0) {
-                    validation_message_t response;
-                    response.type = MSG_VALIDATION_RESULT;
-                    response.instance_id = -1; // From coordinator
-                    response.sync_point = msg->sync_point;
-                    response.validation_passed = match;
-                    
-                    // Send OTHER instance's fingerprint so client can compare locally
-                    if (g_coordinator_state.num_instances == 2) {
-                        int other_idx = (i == 0) ? 1 : 0;  // Get the other instance's index
-                        strncpy(response.mismatch_details, g_coordinator_state.fingerprints[other_idx], 
-                               sizeof(response.mismatch_details) - 1);
-                        response.mismatch_details[sizeof(response.mismatch_details) - 1] = '\0';
-                    } else {
-                        response.mismatch_details[0] = '\0';
-                    }
-                    
-                    ssize_t sent = send(client_fd, &response, sizeof(response), MSG_NOSIGNAL);
-                    if (sent != sizeof(response)) {
-                        printf("⚠️ Failed to send response to instance %d\n", instance_id);
-                    } else {
-                        printf("📤 Sent validation result to instance %d (fd=%d)\n", instance_id, client_fd);
-                    }
-                }
-            }
+        if (elapsed_ms(&start) > WAIT_TIMEOUT_MS) {
+            return 0;
         }
+        usleep(100);
     }
+    compare_published();
+    return load_int(&g_validation->validation_failed) ? -1 : 1;
 }
 
-// Coordinator thread function
-void* coordinator_thread_func(void* arg) {
-    validation_context_t *ctx = (validation_context_t*)arg;
-    fd_set master_fds, read_fds;
-    int max_fd = ctx->server_socket;
-    int client_fds[MAX_INSTANCES];
-    int registered_instances = 0;
-    
-    // Initialize client file descriptors
-    for (int i = 0; i < MAX_INSTANCES; i++) {
-        client_fds[i] = -1;
+void cleanup_cross_validation() {
+    if (!g_validation_enabled || !g_validation_context) return;
+
+    // Check the sync points since the last batch before leaving
+    if (g_validation && !load_int(&g_validation->validation_failed)) {
+        long last = g_states[g_instance_id].published;
+        int ret = wait_for_instances(all_published, last);
+        if (ret > 0) {
+            printf("✅ SYNCHRONIZED MATCH at all %ld sync points across %d instances\n",
+                   last, g_validation->num_instances);
+        } else if (ret == 0) {
+            printf("⚠️ Instance %d timeout waiting for the final sync points\n", g_instance_id);
+        }
+        __atomic_store_n(&g_states[g_instance_id].done, 1, __ATOMIC_RELEASE);
     }
-    
-    FD_ZERO(&master_fds);
-    FD_SET(ctx->server_socket, &master_fds);
-    
-    printf("🎯 Unix socket coordinator thread started, waiting for %d instances\n", ctx->num_instances);
+
+    close_validation_memory();
+
+    free(g_validation_context);
+    g_validation_context = NULL;
+
+    g_validation_enabled = 0;
+    printf("🧹 Instance %d cleaned up shared-memory cross-validation\n", g_instance_id);
     fflush(stdout);
-    
-    // Set timeout for select to avoid indefinite blocking
-    struct timeval tv;
-    
-    while (registered_instances < ctx->num_instances) {
-        read_fds = master_fds;
-        
-        // Use 100ms timeout for select
-        tv.tv_sec = 0;
-        tv.tv_usec = 100000;
-        
-        int ret = select(max_fd + 1, &read_fds, NULL, NULL, &tv);
-        if (ret < 0) {
-            if (errno == EINTR) {
-                // Interrupted by signal (likely checkpoint), continue
-                continue;
-            }
-            perror("select failed in coordinator");
-            break;
-        }
-        
-        if (ret == 0) {
-            // Timeout - no events, continue loop
-            continue;
-        }
-        
-        // Check for new connections
-        if (FD_ISSET(ctx->server_socket, &read_fds)) {
-            struct sockaddr_un client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            int client_fd = accept(ctx->server_socket, (struct sockaddr*)&client_addr, &client_len);
-            
-            if (client_fd < 0) {
-                if (errno == EINTR) {
-                    continue;
-                }
-                perror("accept failed");
-                continue;
-            }
-            
-            // Set new client socket to non-blocking
-            int flags = fcntl(client_fd, F_GETFL, 0);
-            fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
-            
-            FD_SET(client_fd, &master_fds);
-            if (client_fd > max_fd) {
-                max_fd = client_fd;
-            }
-            
-            printf("🔗 New Unix socket client connected: fd=%d\n", client_fd);
-            fflush(stdout);
-        }
-        
-        // Check for messages from existing clients
-        for (int fd = 0; fd <= max_fd; fd++) {
-            if (fd != ctx->server_socket && FD_ISSET(fd, &read_fds)) {
-                validation_message_t msg;
-                int result = receive_validation_message(fd, &msg);
-                
-                if (result == -2) {
-                    // Timeout or would block - continue
-                    continue;
-                }
-                
-                if (result <= 0) {
-                    // Client disconnected or error
-                    close(fd);
-                    FD_CLR(fd, &master_fds);
-                    continue;
-                }
-                
-                if (msg.type == MSG_REGISTER_INSTANCE) {
-                    client_fds[msg.instance_id] = fd;
-                    g_client_fds[msg.instance_id] = fd;
-                    registered_instances++;
-                    printf("✅ Instance %d registered (fd=%d), total: %d/%d\n", 
-                           msg.instance_id, fd, registered_instances, ctx->num_instances);
-                    fflush(stdout);
-                } else if (msg.type == MSG_SYNC_POINT) {
-                    handle_sync_point_message(&msg);
-                } else if (msg.type == MSG_SHUTDOWN) {
-                    printf("🛑 Instance %d shutting down\n", msg.instance_id);
-                    fflush(stdout);
-                }
-            }
-        }
+}
+
+// Write the fingerprint to this instance's ring.  Only every batch-th sync
+// point waits for the other instances; in between, the fingerprints they
+// have published are compared without blocking.
+void cross_validate_sync_point(sync_point_t sync_point, const double *values, int count) {
+    if (!g_validation_enabled || !g_validation_context || !g_validation) {
+        return;
     }
     
-    printf("🎯 All instances registered, Unix socket coordinator ready for validation\n");
-    fflush(stdout);
+    // Skip validation if checkpoint is in progress
+    if (checkpoint_in_progress) {
+        printf("[CV-DEBUG] Skipping validation during checkpoint\n");
+        return;
+    }
     
-    // Continue handling messages until shutdown
-    while (1) {
-        read_fds = master_fds;
-        
-        // Use 100ms timeout
-        tv.tv_sec = 0;
-        tv.tv_usec = 100000;
-        
-        int ret = select(max_fd + 1, &read_fds, NULL, NULL, &tv);
-        if (ret < 0) {
-            if (errno == EINTR) {
-                // Interrupted by signal, continue
-                continue;
+    if (load_int(&g_validation->validation_failed)) {
+        return;
+    }
+
+    long unique_sync_point = ++g_sync_point_counter;
+
+    if (!ring_slot_free(unique_sync_point)) {
+        int ret = wait_for_instances(ring_slot_free, unique_sync_point);
+        if (ret <= 0) {
+            if (ret == 0) {
+                printf("⚠️ Instance %d timeout waiting for a free ring slot, validation disabled\n", g_instance_id);
+                g_validation_enabled = 0;
             }
-            perror("select failed in coordinator main loop");
-            break;
-        }
-        
-        if (ret == 0) {
-            // Timeout - no events, continue
-            continue;
+            return;
         }
-        
-        for (int fd = 0; fd <= max_fd; fd++) {
-            if (fd != ctx->server_socket && FD_ISSET(fd, &read_fds)) {
-                validation_message_t msg;
-                int result = receive_validation_message(fd, &msg);
-                
-                if (result == -2) {
-                    // Timeout or would block - continue
-                    continue;
-                }
-                
-                if (result <= 0) {
-                    close(fd);
-                    FD_CLR(fd, &master_fds);
-                    continue;
-                }
-                
-                if (msg.type == MSG_SYNC_POINT) {
-                    handle_sync_point_message(&msg);
-                } else if (msg.type == MSG_SHUTDOWN) {
-                    printf("🛑 Instance %d shutting down\n", msg.instance_id);
-                    fflush(stdout);
-                }
-            }
+    }
+
+    generate_fingerprint(ring_slot(g_instance_id, unique_sync_point), sync_point, values, count);
+    __atomic_store_n(&g_states[g_instance_id].published, unique_sync_point, __ATOMIC_RELEASE);
+
+    if (unique_sync_point % g_validation->batch == 0) {
+        int ret = wait_for_instances(all_published, unique_sync_point);
+        if (ret > 0) {
+            printf("✅ SYNCHRONIZED MATCH through sync point %ld\n", unique_sync_point);
+            fflush(stdout);
+        } else if (ret == 0) {
+            printf("⚠️ Instance %d timeout waiting for sync point %ld\n", g_instance_id, unique_sync_point);
+            fflush(stdout);
         }
+    } else {
+        compare_published();
     }
-    
-    return NULL;
 }
 
 #ifdef DMTCP
@@ -751,7 +453,7 @@ static void cross_validation_EventHook(DmtcpEvent_t event, DmtcpEventData_t *dat
             break;
             
         case DMTCP_EVENT_PRECHECKPOINT:
-            printf("[CV-DEBUG] DMTCP Pre-checkpoint: Closing validation sockets\n");
+            printf("[CV-DEBUG] DMTCP Pre-checkpoint: Unmapping validation memory\n");
             fflush(stdout);
             
             if (g_validation_context) {
@@ -759,8 +461,8 @@ static void cross_validation_EventHook(DmtcpEvent_t event, DmtcpEventData_t *dat
                 saved_instance_id = g_validation_context->instance_id;
                 saved_num_instances = g_validation_context->num_instances;
                 
-                // Close all sockets to prevent DMTCP from trying to checkpoint them
-                close_validation_sockets();
+                // Unmap the segment so that DMTCP does not checkpoint it
+                close_validation_memory();
                 
                 // Free the context
                 free(g_validation_context);
@@ -778,7 +480,6 @@ static void cross_validation_EventHook(DmtcpEvent_t event, DmtcpEventData_t *dat
             if (saved_instance_id >= 0 && saved_num_instances > 0) {
                 // Reset globals
                 g_sync_point_counter = 0;
-                memset(g_client_fds, -1, sizeof(g_client_fds));
                 
                 // Small delay to ensure both processes are ready
                 usleep(500000); // 500ms
@@ -817,4 +518,4 @@ static DmtcpPluginDescriptor_t cross_validation_plugin = {
 
 // Register the plugin (this macro expands to the constructor function)
 DMTCP_DECL_PLUGIN(cross_validation_plugin);
-#endif // DMTCP
\ No newline at end of file
+#endif // DMTCP
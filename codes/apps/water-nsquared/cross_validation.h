@@ -9,12 +9,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <semaphore.h>
 #include <errno.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <pthread.h>
-#include <sys/select.h>
 
 // DMTCP integration for checkpoint awareness
 #ifdef DMTCP
@@ -22,11 +17,15 @@
 #include "dmtcpalloc.h"
 #endif
 
+// Defaults; CROSS_VALIDATION_MAX_INSTANCES, CROSS_VALIDATION_MAX_SYNC_POINTS
+// and CROSS_VALIDATION_BATCH override them at run time
 #define MAX_INSTANCES 4
-#define MAX_FINGERPRINT_LEN 256
-#define MAX_SYNC_POINTS 20
+#define MAX_SYNC_POINTS 20     // Sync points each instance's ring holds
+#define SYNC_BATCH 10          // Instances block at every SYNC_BATCH-th sync point
+#define MAX_FINGERPRINT_VALUES 8
 #define FLOAT_TOLERANCE 1e-10  // Tolerance for floating-point comparisons
-#define SOCKET_PATH_BASE "/tmp/water_validation_socket"
+#define SHM_NAME "/water_validation_shared"
+#define VALIDATION_MAGIC 0x5741544552435631L
 
 // Sync point identifiers
 typedef enum {
@@ -53,49 +52,42 @@ typedef enum {
     SYNC_MAX
 } sync_point_t;
 
-// Message types for socket communication
-typedef enum {
-    MSG_REGISTER_INSTANCE = 1,
-    MSG_SYNC_POINT = 2,
-    MSG_VALIDATION_RESULT = 3,
-    MSG_SHUTDOWN = 4,
-    MSG_HEARTBEAT = 5,
-    MSG_RESUME_READY = 6
-} message_type_t;
+// Binary fingerprint of one sync point: the checked doubles themselves
+typedef struct {
+    int sync_point;                         // sync_point_t of the call site
+    int count;                              // Number of values used
+    double values[MAX_FINGERPRINT_VALUES];
+} fingerprint_t;
 
-// Socket message structure
+// Progress of one instance, on its own cache line
 typedef struct {
-    message_type_t type;
-    int instance_id;
-    sync_point_t sync_point;
-    char fingerprint[MAX_FINGERPRINT_LEN];
-    int validation_passed;
-    char mismatch_details[512];
-} validation_message_t;
+    volatile long published;  // Last sync point written to the ring
+    volatile long checked;    // Last sync point compared against all others
+    volatile int done;        // Instance has published its last sync point
+    char pad[64 - 2 * sizeof(long) - sizeof(int)];
+} instance_state_t;
 
-// Validation context for socket-based cross-validation
+// Validation context of this instance
 typedef struct {
-    int server_socket;      // Server socket (coordinator)
-    int client_socket;      // Client socket (instance)
-    int is_coordinator;     // Whether this instance is the coordinator
+    int is_coordinator;     // Whether this instance creates the shared memory
     int instance_id;        // Instance ID
     int num_instances;      // Total number of instances
-    pthread_t coordinator_thread; // Coordinator thread handle
+    int shm_fd;             // Shared memory object
+    size_t shm_size;        // Size of the mapping
 } validation_context_t;
 
-// Shared memory structure for cross-instance validation (legacy)
+// Shared memory segment for cross-instance validation.  It is followed by
+// one instance_state_t per instance and one ring of ring_slots fingerprints
+// per instance; sync point n of an instance is in slot n % ring_slots.
 typedef struct {
-    sem_t instance_sem[MAX_INSTANCES];  // One semaphore per instance
-    sem_t coordinator_sem;              // Coordinator semaphore
-    
+    long magic;                         // VALIDATION_MAGIC once initialized
     int num_instances;                  // Total number of instances
-    int current_sync_point;             // Current sync point being validated
-    int instances_arrived;              // Number of instances that reached current sync point
-    
-    char fingerprints[MAX_INSTANCES][MAX_FINGERPRINT_LEN];  // Fingerprints from each instance
-    int instance_ids[MAX_INSTANCES];    // Instance IDs
-    
-    int validation_failed;              // Flag indicating validation failure
+    int ring_slots;                     // Fingerprints in each ring
+    int batch;                          // Blocking interval (sync points)
+    volatile int attached;              // Instances that mapped the segment
+
+    volatile int validation_failed;     // Flag indicating validation failure
+    int pad;                            // Explicit padding to a long boundary
     char mismatch_details[512];         // Details of the mismatch
 } cross_validation_t;
 
@@ -108,43 +100,35 @@ extern int g_validation_enabled;
 // Function prototypes
 int init_cross_validation(int instance_id, int num_instances);
 void cleanup_cross_validation();
-void cross_validate_sync_point(sync_point_t sync_point, const char *fingerprint);
-void generate_fingerprint(char *buffer, size_t buffer_size, const char *format, ...);
-int compare_fingerprints_with_tolerance(const char *fp1, const char *fp2);
+void cross_validate_sync_point(sync_point_t sync_point, const double *values, int count);
+void generate_fingerprint(fingerprint_t *fp, sync_point_t sync_point, const double *values, int count);
+int compare_fingerprints_with_tolerance(const fingerprint_t *fp1, const fingerprint_t *fp2);
 void cleanup_validation_memory();
 int check_memory_availability();
 int is_system_ready_for_checkpoint();
-ssize_t dmtcp_aware_receive(int socket_fd, void *buffer, size_t length, int timeout_seconds);
-int send_validation_message(validation_message_t *msg);
-int receive_validation_message(int client_socket, validation_message_t *msg);
-void handle_sync_point_message(validation_message_t *msg);
-void* coordinator_thread_func(void* arg);
 
 // DMTCP checkpoint-aware functions
 #ifdef DMTCP
 void dmtcp_event_hook(DmtcpEvent_t event, DmtcpEventData_t *data);
 void checkpoint_validation_state();
 void restore_validation_state();
-int reestablish_socket_connections();
 int reinitialize_cross_validation_after_restart();
 #endif
 
-// Macros for easy integration
+// Macros for easy integration: the arguments are the doubles to check
 #define CROSS_VALIDATE_SYNC(sync_point, ...) \
     do { \
         if (g_validation_enabled) { \
-            char _fingerprint[MAX_FINGERPRINT_LEN]; \
-            generate_fingerprint(_fingerprint, sizeof(_fingerprint), __VA_ARGS__); \
-            cross_validate_sync_point(sync_point, _fingerprint); \
+            const double _values[] = { __VA_ARGS__ }; \
+            cross_validate_sync_point(sync_point, _values, \
+                                      (int)(sizeof(_values) / sizeof(_values[0]))); \
         } \
     } while(0)
 
 #define CROSS_VALIDATE_ASSERT(sync_point, ...) \
     do { \
         if (g_validation_enabled) { \
-            char _fingerprint[MAX_FINGERPRINT_LEN]; \
-            generate_fingerprint(_fingerprint, sizeof(_fingerprint), __VA_ARGS__); \
-            cross_validate_sync_point(sync_point, _fingerprint); \
+            CROSS_VALIDATE_SYNC(sync_point, __VA_ARGS__); \
             if (g_validation && g_validation->validation_failed) { \
                 fprintf(stderr, "❌ ASSERTION FAILED at sync point %d: %s\n", \
                         sync_point, g_validation->mismatch_details); \
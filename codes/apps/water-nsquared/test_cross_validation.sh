@@ -1,11 +1,11 @@
 #!/bin/bash
 
-# Test script for socket-based cross-validation system
-# Usage: ./test_socket_validation.sh [mcmini]
+# Test script for shared-memory cross-validation system
+# Usage: ./test_cross_validation.sh [mcmini]
 
 MODE=${1:-normal}
 
-echo "🧪 Testing socket-based cross-validation system..."
+echo "🧪 Testing shared-memory cross-validation system..."
 
 if [ "$MODE" = "mcmini" ]; then
     echo "🔧 Running with McMini for deterministic execution"
@@ -15,23 +15,23 @@ fi
 
 cd /home/aayushi/benchmarks/splash2/codes/apps/water-nsquared
 
-# Clean up any existing socket files and create run directories
-rm -f /tmp/water_validation_socket
+# Clean up any stale validation segment and create run directories
+rm -f /dev/shm/water_validation_shared
 if [ "$MODE" = "mcmini" ]; then
     rm -rf /tmp/mcmini_test1 /tmp/mcmini_test2
     mkdir -p /tmp/mcmini_test1 /tmp/mcmini_test2
 fi
 
 # Run 2 instances of water with validation enabled
-echo "🚀 Running 2 instances of WATER-NSQUARED with socket validation..."
-echo "   Instance 0 will be the coordinator (server)"
-echo "   Instance 1 will be the client"
+echo "🚀 Running 2 instances of WATER-NSQUARED with shared-memory validation..."
+echo "   Instance 0 will be the coordinator (creates the shared memory)"
+echo "   Instance 1 will attach to it"
 
 # Run with validation enabled - 2 instances
 echo "📝 Input file contents:"
 cat input
 echo ""
-echo "🔌 Starting socket-based cross-validation with 2 instances..."
+echo "🔌 Starting shared-memory cross-validation with 2 instances..."
 
 # Start coordinator instance (instance 0)
 echo "Starting instance 0 (coordinator)..."
@@ -50,7 +50,7 @@ else
 fi
 PID1=$!
 
-sleep 2  # Give coordinator time to set up socket
+sleep 2  # Give coordinator time to set up the shared memory
 
 # Start client instance (instance 1)
 echo "Starting instance 1 (client)..."
@@ -115,9 +115,8 @@ if [ "$MODE" = "mcmini" ]; then
 fi
 
 echo ""
-echo "✅ Socket-based cross-validation test completed!"
-echo "   - Check output above for socket communication messages"
-echo "   - Look for '🔧 Instance X' messages indicating socket activity"
+echo "✅ Shared-memory cross-validation test completed!"
+echo "   - Look for 'SYNCHRONIZED MATCH' messages every CROSS_VALIDATION_BATCH sync points"
 echo "   - Assertion will trigger if fingerprints don't match between processes"
 if [ "$MODE" = "mcmini" ]; then
     echo "   - McMini provided deterministic execution for race condition detection"
@@ -0,0 +1,1087 @@
+dnl Process creation and environment macros shared by the POSIX macro sets.
+dnl Each set includes this file (Makefile.config puts null_macros on the m4
+dnl include path) and defines SPLASH_EXTRA_DECLS and SPLASH_EXTRA_DEFS, which
+dnl are spliced into EXTERN_ENV and MAIN_ENV for set-specific declarations
+dnl and out-of-line code.
+dnl
+dnl The thread table is sized by CREATE at run time, so there is no cap on
+dnl the number of processes.  CREATE also pins every thread, including the
+dnl main thread, according to SPLASH_AFFINITY:
+dnl
+dnl	none	 leave placement to the scheduler (the default)
+dnl	compact	 fill the cores of one NUMA node before moving to the next
+dnl	scatter	 round-robin over sockets, one thread per core first
+dnl	numa	 round-robin over NUMA nodes, one thread per core first
+dnl	list	 use the CPUs in SPLASH_CPUS, e.g. "0-15,32-47", in order
+dnl
+dnl Setting SPLASH_CPUS alone implies list.  Thread i is bound to the
+dnl (i mod n)-th CPU of the resulting order.  Only CPUs in the affinity
+dnl mask the program was started with are considered.
+dnl
+dnl The shared memory allocation macros call SplashMalloc.  With neither
+dnl SPLASH_PLACEMENT nor SPLASH_HUGEPAGES set it is plain malloc.  Otherwise
+dnl requests of SPLASH_PLACE_MIN bytes and up get their own anonymous
+dnl mapping, placed according to SPLASH_PLACEMENT:
+dnl
+dnl	interleave	 pages round-robin over all memory nodes
+dnl	stripe		 one contiguous stripe per memory node, stripe k on node k
+dnl	owner		 nothing is placed up front, so pages land where they
+dnl			 are first touched
+dnl
+dnl Under stripe and owner, G_PLACE(start, size, pid) moves the whole pages
+dnl of a range to the node of process pid, and the home argument of
+dnl NU_MALLOC places a new region the same way; programs use these to say
+dnl which partition each process owns.  The node of a process is that of
+dnl the CPU SPLASH_AFFINITY binds it to; without affinity a process placing
+dnl its own data gets the node it is running on, and other hints go
+dnl round-robin over the memory nodes.  PROCESS_NODE(pid) gives the node of
+dnl process pid, or -1 without affinity, for programs that group their
+dnl processes by node.  SPLASH_HUGEPAGES=2M or 1G backs the mappings with
+dnl hugetlbfs pages (normal pages when none are reserved), and
+dnl SPLASH_HUGEPAGES=thp asks for transparent huge pages.  LLC_SIZE(default)
+dnl is the size in bytes of the last level cache of CPU 0, or default if
+dnl sysfs does not give it.
+dnl
+dnl CLOCK reads CLOCK_MONOTONIC and keeps reporting microseconds, so the
+dnl figures the programs print do not change meaning; NS_CLOCK gives
+dnl nanoseconds.  PHASE_BEGIN("name") and PHASE_END("name") bracket a
+dnl named region of a thread; regions may nest and are matched by name.
+dnl They, and the barrier wait accounting built into every BARRIER, cost a
+dnl single test unless SPLASH_STATS is set:
+dnl
+dnl	json, csv	 at exit, write one row per thread and phase (count,
+dnl			 total and longest nanoseconds) to SPLASH_STATS_FILE,
+dnl			 or to stderr.  Phase total is the life of the thread,
+dnl			 phase barrier_wait the time spent inside barriers.
+dnl
+dnl SPLASH_PERF=all, or a comma separated subset of cycles, instructions,
+dnl llc_misses and remote_accesses, adds per-thread perf_event_open(2)
+dnl counts to every phase; events the kernel refuses are reported as null.
+
+define(WAIT_FOR_END, `{
+	unsigned long	i, Error;
+	for (i = 0; i < ($1) - 1; i++) {
+		Error = pthread_join(PThreadTable[i], NULL);
+		if (Error != 0) {
+			printf("Error in pthread_join().\n");
+			exit(-1);
+		}
+	}
+}')
+
+define(CREATE, `{
+	long	i, Error;
+
+	SplashThreadSetup((void (*)(void))($1), ($2));
+	for (i = 0; i < ($2) - 1; i++) {
+		Error = pthread_create(&PThreadTable[i], NULL, SplashThreadStart, (void *)(i + 1));
+		if (Error != 0) {
+			printf("Error in pthread_create().\n");
+			exit(-1);
+		}
+	}
+
+	SplashThreadBind(0);
+	$1();
+}')
+
+define(SPLASH_ENV_DECLS, `
+#ifndef SPLASH_ENV_DECLARED
+#define SPLASH_ENV_DECLARED
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#define SPLASH_CACHE_LINE	64
+#define SPLASH_MAX_CPUS		4096
+#define SPLASH_MAX_PHASES	64
+#define SPLASH_MAX_NESTING	16
+#define SPLASH_PERF_EVENTS	4
+
+extern pthread_t *PThreadTable;
+extern __thread long SplashThreadId;
+
+void SplashThreadSetup(void (*Entry)(void), long Procs);
+void *SplashThreadStart(void *Arg);
+void SplashThreadBind(long Id);
+void *SplashMalloc(size_t Size, long Home);
+void SplashFree(void *Ptr);
+void SplashPlace(void *Start, size_t Size, long Owner);
+long SplashProcessNode(long Id);
+long SplashLLCSize(long Default);
+
+extern int SplashStatsOn;
+unsigned long long SplashClockNs(void);
+void SplashPhaseBegin(const char *Name);
+void SplashPhaseEnd(const char *Name);
+void SplashWaitBegin(void);
+void SplashWaitEnd(void);
+SPLASH_EXTRA_DECLS
+#endif
+')
+
+define(SPLASH_ENV_DEFS, `
+#include <stdio.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#if !defined(__USE_MISC)
+extern long int syscall(long int, ...);
+#endif
+
+pthread_t *PThreadTable = NULL;
+__thread long SplashThreadId = 0;
+
+static void (*SplashThreadEntry)(void);
+static long SplashThreadTableSize = 0;
+static long *SplashCpuOrder = NULL;
+static long SplashCpuCount = -1;
+static long *SplashCpuNode = NULL;
+
+/* Attributes of a CPU; SplashCpuSort orders CPUs by up to four of them. */
+#define SPLASH_CPU	0
+#define SPLASH_NODE	1
+#define SPLASH_PACKAGE	2
+#define SPLASH_CORE	3
+#define SPLASH_SIBLING	4
+#define SPLASH_SLOT	5
+
+typedef struct SplashCpu {
+	long	Key[4];
+	long	Attr[6];
+} SplashCpu;
+
+static int SplashCpuCompare(const void *A, const void *B)
+{
+	const SplashCpu	*CpuA = (const SplashCpu *) A;
+	const SplashCpu	*CpuB = (const SplashCpu *) B;
+	long		k;
+
+	for (k = 0; k < 4; k++) {
+		if (CpuA->Key[k] != CpuB->Key[k]) {
+			return (CpuA->Key[k] < CpuB->Key[k]) ? -1 : 1;
+		}
+	}
+	return (CpuA->Attr[SPLASH_CPU] < CpuB->Attr[SPLASH_CPU]) ? -1 :
+	       (CpuA->Attr[SPLASH_CPU] > CpuB->Attr[SPLASH_CPU]);
+}
+
+/* Sort by the attributes K0..K3; a negative attribute is ignored. */
+static void SplashCpuSort(SplashCpu *Cpus, long Count, long K0, long K1, long K2, long K3)
+{
+	long	i;
+
+	for (i = 0; i < Count; i++) {
+		Cpus[i].Key[0] = (K0 < 0) ? 0 : Cpus[i].Attr[K0];
+		Cpus[i].Key[1] = (K1 < 0) ? 0 : Cpus[i].Attr[K1];
+		Cpus[i].Key[2] = (K2 < 0) ? 0 : Cpus[i].Attr[K2];
+		Cpus[i].Key[3] = (K3 < 0) ? 0 : Cpus[i].Attr[K3];
+	}
+	qsort(Cpus, Count, sizeof(SplashCpu), SplashCpuCompare);
+}
+
+static long SplashReadSysLong(const char *Format, long Arg)
+{
+	char	Path[128];
+	FILE	*File;
+	long	Value = 0;
+
+	snprintf(Path, sizeof(Path), Format, Arg);
+	File = fopen(Path, "r");
+	if (File == NULL) {
+		return 0;
+	}
+	if (fscanf(File, "%ld", &Value) != 1) {
+		Value = 0;
+	}
+	fclose(File);
+	return Value;
+}
+
+/* Size of the last (highest index) cache of CPU 0, or Default. */
+long SplashLLCSize(long Default)
+{
+	char	Path[128], Line[64];
+	FILE	*File;
+	long	i, Size = 0;
+
+	for (i = 0; i < 8; i++) {
+		snprintf(Path, sizeof(Path), "/sys/devices/system/cpu/cpu0/cache/index%ld/size", i);
+		File = fopen(Path, "r");
+		if (File == NULL) {
+			break;
+		}
+		if (fgets(Line, sizeof(Line), File) != NULL) {
+			Size = atol(Line);
+			if (strstr(Line, "K") != NULL) {
+				Size *= 1024;
+			} else if (strstr(Line, "M") != NULL) {
+				Size *= 1024 * 1024;
+			}
+		}
+		fclose(File);
+	}
+	return (Size > 0) ? Size : Default;
+}
+
+/* Parse a Linux cpulist ("0-3,8,10-11") into Cpus; returns the count. */
+static long SplashParseCpuList(const char *List, long *Cpus, long Max)
+{
+	const char	*p = List;
+	char		*End;
+	long		First, Last, Count = 0;
+
+	while (*p != 0) {
+		First = strtol(p, &End, 10);
+		if (End == p || First < 0) {
+			return -1;
+		}
+		Last = First;
+		p = End;
+		if (strncmp(p, "-", 1) == 0) {
+			Last = strtol(p + 1, &End, 10);
+			if (End == p + 1 || Last < First) {
+				return -1;
+			}
+			p = End;
+		}
+		for (; First <= Last && Count < Max; First++) {
+			Cpus[Count++] = First;
+		}
+		p += strspn(p, ", \n");
+	}
+	return Count;
+}
+
+/* NUMA node of every CPU, from /sys/devices/system/node/nodeN/cpulist. */
+static void SplashReadCpuNodes(void)
+{
+	DIR		*Dir;
+	struct dirent	*Entry;
+	char		Path[128], Line[4096];
+	FILE		*File;
+	long		i, Node, Count, *Members;
+
+	if (SplashCpuNode != NULL) {
+		return;
+	}
+	SplashCpuNode = (long *) calloc(SPLASH_MAX_CPUS, sizeof(long));
+	Members = (long *) malloc(SPLASH_MAX_CPUS * sizeof(long));
+	Dir = opendir("/sys/devices/system/node");
+	while (Dir != NULL && (Entry = readdir(Dir)) != NULL) {
+		if (strncmp(Entry->d_name, "node", 4) != 0 ||
+		    sscanf(Entry->d_name + 4, "%ld", &Node) != 1) {
+			continue;
+		}
+		snprintf(Path, sizeof(Path), "/sys/devices/system/node/node%ld/cpulist", Node);
+		File = fopen(Path, "r");
+		if (File == NULL) {
+			continue;
+		}
+		if (fgets(Line, sizeof(Line), File) != NULL) {
+			Count = SplashParseCpuList(Line, Members, SPLASH_MAX_CPUS);
+			for (i = 0; i < Count; i++) {
+				if (Members[i] < SPLASH_MAX_CPUS) {
+					SplashCpuNode[Members[i]] = Node;
+				}
+			}
+		}
+		fclose(File);
+	}
+	if (Dir != NULL) {
+		closedir(Dir);
+	}
+	free(Members);
+}
+
+static void SplashAffinityInit(void)
+{
+	const char	*Policy = getenv("SPLASH_AFFINITY");
+	const char	*List = getenv("SPLASH_CPUS");
+	unsigned long	Mask[SPLASH_MAX_CPUS / (8 * sizeof(unsigned long))];
+	SplashCpu	*Cpus;
+	long		i, Count, By;
+
+	SplashCpuCount = 0;
+	if (Policy != NULL && *Policy == 0) {
+		Policy = NULL;
+	}
+	if (Policy == NULL && List != NULL) {
+		Policy = "list";
+	}
+	if (Policy == NULL || strcmp(Policy, "none") == 0) {
+		return;
+	}
+	SplashCpuOrder = (long *) malloc(SPLASH_MAX_CPUS * sizeof(long));
+	if (strcmp(Policy, "list") == 0) {
+		SplashCpuCount = (List == NULL) ? -1 :
+			SplashParseCpuList(List, SplashCpuOrder, SPLASH_MAX_CPUS);
+		if (SplashCpuCount <= 0) {
+			printf("Error: SPLASH_CPUS must list CPUs for SPLASH_AFFINITY=list.\n");
+			exit(-1);
+		}
+		return;
+	}
+	if (strcmp(Policy, "compact") != 0 && strcmp(Policy, "scatter") != 0 &&
+	    strcmp(Policy, "numa") != 0) {
+		printf("Error: unknown SPLASH_AFFINITY policy %s.\n", Policy);
+		exit(-1);
+	}
+
+	memset(Mask, 0, sizeof(Mask));
+	if (syscall(SYS_sched_getaffinity, 0, sizeof(Mask), Mask) < 0) {
+		printf("Error in sched_getaffinity().\n");
+		exit(-1);
+	}
+	SplashReadCpuNodes();
+	Cpus = (SplashCpu *) calloc(SPLASH_MAX_CPUS, sizeof(SplashCpu));
+	for (i = 0, Count = 0; i < SPLASH_MAX_CPUS; i++) {
+		if (Mask[i / (8 * sizeof(unsigned long))] & (1ul << (i % (8 * sizeof(unsigned long))))) {
+			Cpus[Count].Attr[SPLASH_CPU] = i;
+			Cpus[Count].Attr[SPLASH_NODE] = SplashCpuNode[i];
+			Cpus[Count].Attr[SPLASH_PACKAGE] = SplashReadSysLong(
+				"/sys/devices/system/cpu/cpu%ld/topology/physical_package_id", i);
+			Cpus[Count].Attr[SPLASH_CORE] = SplashReadSysLong(
+				"/sys/devices/system/cpu/cpu%ld/topology/core_id", i);
+			Count++;
+		}
+	}
+
+	/* Hyperthread rank of every CPU within its core. */
+	SplashCpuSort(Cpus, Count, SPLASH_PACKAGE, SPLASH_CORE, -1, -1);
+	for (i = 1; i < Count; i++) {
+		if (Cpus[i - 1].Attr[SPLASH_PACKAGE] == Cpus[i].Attr[SPLASH_PACKAGE] &&
+		    Cpus[i - 1].Attr[SPLASH_CORE] == Cpus[i].Attr[SPLASH_CORE]) {
+			Cpus[i].Attr[SPLASH_SIBLING] = Cpus[i - 1].Attr[SPLASH_SIBLING] + 1;
+		}
+	}
+
+	if (strcmp(Policy, "compact") == 0) {
+		SplashCpuSort(Cpus, Count, SPLASH_NODE, SPLASH_PACKAGE, SPLASH_CORE, SPLASH_SIBLING);
+	} else {
+		/* Number the CPUs of each group (socket or node) one core at a
+		   time, then deal the groups out round-robin by that number. */
+		By = (strcmp(Policy, "scatter") == 0) ? SPLASH_PACKAGE : SPLASH_NODE;
+		SplashCpuSort(Cpus, Count, By, SPLASH_SIBLING, SPLASH_CORE, -1);
+		for (i = 1; i < Count; i++) {
+			if (Cpus[i - 1].Attr[By] == Cpus[i].Attr[By]) {
+				Cpus[i].Attr[SPLASH_SLOT] = Cpus[i - 1].Attr[SPLASH_SLOT] + 1;
+			}
+		}
+		SplashCpuSort(Cpus, Count, SPLASH_SLOT, By, -1, -1);
+	}
+	for (i = 0; i < Count; i++) {
+		SplashCpuOrder[i] = Cpus[i].Attr[SPLASH_CPU];
+	}
+	SplashCpuCount = Count;
+	free(Cpus);
+}
+
+#define SPLASH_PHASE_TOTAL	0
+#define SPLASH_PHASE_WAIT	1
+
+typedef struct SplashPhaseStats {
+	unsigned long		Count;
+	unsigned long long	Ns;
+	unsigned long long	MaxNs;
+	unsigned long long	Events[SPLASH_PERF_EVENTS];
+} SplashPhaseStats;
+
+typedef struct SplashStatsThread {
+	long			Id;
+	long			Depth;
+	int			Fd[SPLASH_PERF_EVENTS];
+	long			Open[SPLASH_MAX_NESTING];
+	unsigned long long	Start[SPLASH_MAX_NESTING];
+	unsigned long long	StartEvents[SPLASH_MAX_NESTING][SPLASH_PERF_EVENTS];
+	unsigned long long	WaitStart;
+	SplashPhaseStats	Phase[SPLASH_MAX_PHASES];
+	struct SplashStatsThread *Next;
+} SplashStatsThread;
+
+static const struct {
+	const char	*Name;
+	unsigned long	Type;		/* long, so Config needs no padding */
+	unsigned long	Config;
+} SplashPerfEvent[SPLASH_PERF_EVENTS] = {
+	{"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{"remote_accesses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_NODE |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}
+};
+
+int SplashStatsOn = 0;
+static long SplashStatsCsv = 0;
+static const char *SplashStatsFile = NULL;
+static long SplashPerfWanted[SPLASH_PERF_EVENTS];
+static pthread_mutex_t SplashStatsLock = PTHREAD_MUTEX_INITIALIZER;
+static SplashStatsThread *SplashStatsThreads = NULL;
+static __thread SplashStatsThread *SplashStatsMine = NULL;
+static const char *SplashPhaseNames[SPLASH_MAX_PHASES] = {"total", "barrier_wait"};
+static long SplashPhaseCount = 2;
+
+unsigned long long SplashClockNs(void)
+{
+	struct timespec	Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (unsigned long long) Now.tv_sec * 1000000000ull + (unsigned long long) Now.tv_nsec;
+}
+
+static void SplashPerfRead(SplashStatsThread *Self, unsigned long long *Events)
+{
+	long	k;
+
+	for (k = 0; k < SPLASH_PERF_EVENTS; k++) {
+		Events[k] = 0;
+		if (Self->Fd[k] >= 0 &&
+		    read(Self->Fd[k], &Events[k], sizeof(Events[k])) != sizeof(Events[k])) {
+			Events[k] = 0;
+		}
+	}
+}
+
+static void SplashPhasePush(SplashStatsThread *Self, long Phase)
+{
+	if (Self->Depth == SPLASH_MAX_NESTING) {
+		printf("Error: phases nested more than %d deep.\n", SPLASH_MAX_NESTING);
+		exit(-1);
+	}
+	Self->Open[Self->Depth] = Phase;
+	SplashPerfRead(Self, Self->StartEvents[Self->Depth]);
+	Self->Start[Self->Depth++] = SplashClockNs();
+}
+
+static void SplashPhasePop(SplashStatsThread *Self)
+{
+	unsigned long long	End, Events[SPLASH_PERF_EVENTS];
+	SplashPhaseStats	*Stats;
+	long			k;
+
+	End = SplashClockNs();
+	SplashPerfRead(Self, Events);
+	Self->Depth--;
+	Stats = &Self->Phase[Self->Open[Self->Depth]];
+	Stats->Count++;
+	Stats->Ns += End - Self->Start[Self->Depth];
+	if (End - Self->Start[Self->Depth] > Stats->MaxNs) {
+		Stats->MaxNs = End - Self->Start[Self->Depth];
+	}
+	for (k = 0; k < SPLASH_PERF_EVENTS; k++) {
+		Stats->Events[k] += Events[k] - Self->StartEvents[Self->Depth][k];
+	}
+}
+
+/* Set up the counters of the calling thread and start its total phase. */
+static SplashStatsThread *SplashStatsAttach(void)
+{
+	struct perf_event_attr	Attr;
+	SplashStatsThread	*Self;
+	long			k;
+
+	Self = (SplashStatsThread *) calloc(1, sizeof(SplashStatsThread));
+	if (Self == NULL) {
+		printf("Error while allocating phase statistics.\n");
+		exit(-1);
+	}
+	Self->Id = SplashThreadId;
+	for (k = 0; k < SPLASH_PERF_EVENTS; k++) {
+		Self->Fd[k] = -1;
+		if (!SplashPerfWanted[k]) {
+			continue;
+		}
+		memset(&Attr, 0, sizeof(Attr));
+		Attr.type = SplashPerfEvent[k].Type;
+		Attr.size = sizeof(Attr);
+		Attr.config = SplashPerfEvent[k].Config;
+		Attr.exclude_kernel = 1;
+		Attr.exclude_hv = 1;
+		Self->Fd[k] = (int) syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+	}
+	pthread_mutex_lock(&SplashStatsLock);
+	Self->Next = SplashStatsThreads;
+	SplashStatsThreads = Self;
+	pthread_mutex_unlock(&SplashStatsLock);
+	SplashStatsMine = Self;
+	SplashPhasePush(Self, SPLASH_PHASE_TOTAL);
+	return Self;
+}
+
+/* Close whatever the calling thread still has open, total included. */
+static void SplashStatsDetach(void)
+{
+	SplashStatsThread	*Self = SplashStatsMine;
+	long			k;
+
+	if (Self == NULL) {
+		return;
+	}
+	while (Self->Depth > 0) {
+		SplashPhasePop(Self);
+	}
+	for (k = 0; k < SPLASH_PERF_EVENTS; k++) {
+		if (Self->Fd[k] >= 0) {
+			close(Self->Fd[k]);
+		}
+	}
+	SplashStatsMine = NULL;
+}
+
+static long SplashPhaseLookup(const char *Name)
+{
+	long	i, Count;
+
+	Count = __atomic_load_n(&SplashPhaseCount, __ATOMIC_ACQUIRE);
+	for (i = 0; i < Count; i++) {
+		if (SplashPhaseNames[i] == Name || strcmp(SplashPhaseNames[i], Name) == 0) {
+			return i;
+		}
+	}
+	pthread_mutex_lock(&SplashStatsLock);
+	for (i = Count; i < SplashPhaseCount; i++) {
+		if (strcmp(SplashPhaseNames[i], Name) == 0) {
+			break;
+		}
+	}
+	if (i == SplashPhaseCount) {
+		if (i == SPLASH_MAX_PHASES) {
+			printf("Error: more than %d phases.\n", SPLASH_MAX_PHASES);
+			exit(-1);
+		}
+		SplashPhaseNames[i] = Name;
+		__atomic_store_n(&SplashPhaseCount, i + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&SplashStatsLock);
+	return i;
+}
+
+void SplashPhaseBegin(const char *Name)
+{
+	SplashStatsThread	*Self = SplashStatsMine;
+
+	if (Self == NULL) {
+		Self = SplashStatsAttach();
+	}
+	SplashPhasePush(Self, SplashPhaseLookup(Name));
+}
+
+void SplashPhaseEnd(const char *Name)
+{
+	SplashStatsThread	*Self = SplashStatsMine;
+
+	if (Self == NULL || Self->Depth < 2 ||
+	    strcmp(SplashPhaseNames[Self->Open[Self->Depth - 1]], Name) != 0) {
+		printf("Error: phase %s ended without being begun.\n", Name);
+		exit(-1);
+	}
+	SplashPhasePop(Self);
+}
+
+void SplashWaitBegin(void)
+{
+	if (SplashStatsMine == NULL) {
+		SplashStatsAttach();
+	}
+	SplashStatsMine->WaitStart = SplashClockNs();
+}
+
+void SplashWaitEnd(void)
+{
+	SplashStatsThread	*Self = SplashStatsMine;
+	SplashPhaseStats	*Stats = &Self->Phase[SPLASH_PHASE_WAIT];
+	unsigned long long	Ns = SplashClockNs() - Self->WaitStart;
+
+	Stats->Count++;
+	Stats->Ns += Ns;
+	if (Ns > Stats->MaxNs) {
+		Stats->MaxNs = Ns;
+	}
+}
+
+static void SplashStatsReport(void)
+{
+	SplashStatsThread	**Threads, *Self;
+	char			Program[64];
+	FILE			*Out, *Comm;
+	long			Count, i, j, k, Phase, First;
+
+	SplashStatsDetach();
+	Out = stderr;
+	if (SplashStatsFile != NULL && (Out = fopen(SplashStatsFile, "w")) == NULL) {
+		printf("Error: cannot open SPLASH_STATS_FILE %s.\n", SplashStatsFile);
+		return;
+	}
+	strcpy(Program, "splash");
+	if ((Comm = fopen("/proc/self/comm", "r")) != NULL) {
+		if (fgets(Program, sizeof(Program), Comm) != NULL) {
+			Program[strcspn(Program, "\n\"\\")] = 0;
+		}
+		fclose(Comm);
+	}
+
+	pthread_mutex_lock(&SplashStatsLock);
+	for (Count = 0, Self = SplashStatsThreads; Self != NULL; Self = Self->Next) {
+		Count++;
+	}
+	Threads = (SplashStatsThread **) malloc((Count + 1) * sizeof(SplashStatsThread *));
+	for (i = 0, Self = SplashStatsThreads; Self != NULL; Self = Self->Next) {
+		for (j = i++; j > 0 && Threads[j - 1]->Id > Self->Id; j--) {
+			Threads[j] = Threads[j - 1];
+		}
+		Threads[j] = Self;
+	}
+
+	if (SplashStatsCsv) {
+		fprintf(Out, "program,thread,phase,count,ns,max_ns");
+		for (k = 0; k < SPLASH_PERF_EVENTS; k++) {
+			if (SplashPerfWanted[k]) {
+				fprintf(Out, ",%s", SplashPerfEvent[k].Name);
+			}
+		}
+		fprintf(Out, "\n");
+	} else {
+		fprintf(Out, "{\n  \"program\": \"%s\",\n  \"clock\": \"CLOCK_MONOTONIC\",\n"
+			"  \"threads\": %ld,\n  \"phases\": [", Program, Count);
+	}
+	First = 1;
+	for (i = 0; i < Count; i++) {
+		Self = Threads[i];
+		for (Phase = 0; Phase < SplashPhaseCount; Phase++) {
+			SplashPhaseStats	*Stats = &Self->Phase[Phase];
+
+			if (Stats->Count == 0) {
+				continue;
+			}
+			if (SplashStatsCsv) {
+				fprintf(Out, "%s,%ld,%s,%lu,%llu,%llu", Program, Self->Id,
+					SplashPhaseNames[Phase], Stats->Count, Stats->Ns, Stats->MaxNs);
+			} else {
+				fprintf(Out, "%s\n    {\"thread\": %ld, \"phase\": \"%s\", \"count\": %lu, "
+					"\"ns\": %llu, \"max_ns\": %llu", First ? "" : ",", Self->Id,
+					SplashPhaseNames[Phase], Stats->Count, Stats->Ns, Stats->MaxNs);
+			}
+			First = 0;
+			for (k = 0; k < SPLASH_PERF_EVENTS; k++) {
+				if (!SplashPerfWanted[k]) {
+					continue;
+				}
+				if (SplashStatsCsv) {
+					if (Self->Fd[k] >= 0 && Phase != SPLASH_PHASE_WAIT) {
+						fprintf(Out, ",%llu", Stats->Events[k]);
+					} else {
+						fprintf(Out, ",");
+					}
+				} else if (Self->Fd[k] >= 0 && Phase != SPLASH_PHASE_WAIT) {
+					fprintf(Out, ", \"%s\": %llu", SplashPerfEvent[k].Name, Stats->Events[k]);
+				} else {
+					fprintf(Out, ", \"%s\": null", SplashPerfEvent[k].Name);
+				}
+			}
+			fprintf(Out, SplashStatsCsv ? "\n" : "}");
+		}
+	}
+	if (!SplashStatsCsv) {
+		fprintf(Out, "\n  ]\n}\n");
+	}
+	pthread_mutex_unlock(&SplashStatsLock);
+	free(Threads);
+	if (Out != stderr) {
+		fclose(Out);
+	}
+}
+
+static void SplashStatsInit(void) __attribute__((constructor));
+static void SplashStatsInit(void)
+{
+	const char	*Mode = getenv("SPLASH_STATS");
+	const char	*Events = getenv("SPLASH_PERF");
+	size_t		Length;
+	long		k, Known, Found;
+
+	if (Mode == NULL || *Mode == 0 || strcmp(Mode, "none") == 0) {
+		return;
+	}
+	if (strcmp(Mode, "csv") == 0) {
+		SplashStatsCsv = 1;
+	} else if (strcmp(Mode, "json") != 0) {
+		printf("Error: SPLASH_STATS must be none, json or csv.\n");
+		exit(-1);
+	}
+	SplashStatsFile = getenv("SPLASH_STATS_FILE");
+	if (SplashStatsFile != NULL && *SplashStatsFile == 0) {
+		SplashStatsFile = NULL;
+	}
+	while (Events != NULL && *Events != 0) {
+		Length = strcspn(Events, ",");
+		Found = 0;
+		Known = (Length == 3 && strncmp(Events, "all", 3) == 0);
+		for (k = 0; k < SPLASH_PERF_EVENTS; k++) {
+			if (Known || (Length == strlen(SplashPerfEvent[k].Name) &&
+				      strncmp(Events, SplashPerfEvent[k].Name, Length) == 0)) {
+				SplashPerfWanted[k] = 1;
+				Found = 1;
+			}
+		}
+		if (!Found && Length > 0) {
+			printf("Error: unknown SPLASH_PERF event %.*s.\n", (int) Length, Events);
+			exit(-1);
+		}
+		Events += Length;
+		Events += strspn(Events, ",");
+	}
+	SplashStatsOn = 1;
+	SplashStatsAttach();
+	atexit(SplashStatsReport);
+}
+
+void SplashThreadSetup(void (*Entry)(void), long Procs)
+{
+	SplashThreadEntry = Entry;
+	if (Procs - 1 > SplashThreadTableSize) {
+		PThreadTable = (pthread_t *) realloc(PThreadTable, (Procs - 1) * sizeof(pthread_t));
+		if (PThreadTable == NULL) {
+			printf("Error while allocating the thread table.\n");
+			exit(-1);
+		}
+		SplashThreadTableSize = Procs - 1;
+	}
+	if (SplashCpuCount < 0) {
+		SplashAffinityInit();
+	}
+}
+
+void SplashThreadBind(long Id)
+{
+	unsigned long	Mask[SPLASH_MAX_CPUS / (8 * sizeof(unsigned long))];
+	long		Cpu;
+
+	SplashThreadId = Id;
+	if (SplashCpuCount <= 0) {
+		return;
+	}
+	Cpu = SplashCpuOrder[Id % SplashCpuCount];
+	if (Cpu >= SPLASH_MAX_CPUS) {
+		printf("Error: CPU %ld is out of range.\n", Cpu);
+		exit(-1);
+	}
+	memset(Mask, 0, sizeof(Mask));
+	Mask[Cpu / (8 * sizeof(unsigned long))] |= 1ul << (Cpu % (8 * sizeof(unsigned long)));
+	if (syscall(SYS_sched_setaffinity, 0, sizeof(Mask), Mask) < 0) {
+		printf("Error while binding thread %ld to CPU %ld.\n", Id, Cpu);
+		exit(-1);
+	}
+}
+
+void *SplashThreadStart(void *Arg)
+{
+	SplashThreadBind((long) Arg);
+	if (SplashStatsOn) {
+		SplashStatsAttach();
+	}
+	SplashThreadEntry();
+	if (SplashStatsOn) {
+		SplashStatsDetach();
+	}
+	return NULL;
+}
+
+#ifndef SPLASH_PLACE_MIN
+#define SPLASH_PLACE_MIN	(64 * 1024)
+#endif
+#define SPLASH_MAX_NODES	1024
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS		0x20
+#endif
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB		0x40000
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT		26
+#endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE		14
+#endif
+
+#define SPLASH_PLACE_NONE	0
+#define SPLASH_PLACE_INTERLEAVE	1
+#define SPLASH_PLACE_STRIPE	2
+#define SPLASH_PLACE_OWNER	3
+
+typedef struct SplashRegion {
+	char	*Base;
+	size_t	Length;
+	size_t	PageSize;
+} SplashRegion;
+
+static pthread_once_t SplashPlaceOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t SplashRegionLock = PTHREAD_MUTEX_INITIALIZER;
+static SplashRegion *SplashRegions = NULL;
+static long SplashRegionCount = 0;
+static long SplashRegionMax = 0;
+static long SplashPlacement = SPLASH_PLACE_NONE;
+static long SplashHugeShift = 0;
+static long SplashHugeThp = 0;
+static long SplashMemNodes[SPLASH_MAX_NODES];
+static long SplashMemNodeCount = 0;
+
+static void SplashPlaceInit(void)
+{
+	const char	*Policy = getenv("SPLASH_PLACEMENT");
+	const char	*Huge = getenv("SPLASH_HUGEPAGES");
+	char		Line[4096];
+	FILE		*File;
+
+	if (Policy == NULL || *Policy == 0 || strcmp(Policy, "none") == 0) {
+		SplashPlacement = SPLASH_PLACE_NONE;
+	} else if (strcmp(Policy, "interleave") == 0) {
+		SplashPlacement = SPLASH_PLACE_INTERLEAVE;
+	} else if (strcmp(Policy, "stripe") == 0) {
+		SplashPlacement = SPLASH_PLACE_STRIPE;
+	} else if (strcmp(Policy, "owner") == 0) {
+		SplashPlacement = SPLASH_PLACE_OWNER;
+	} else {
+		printf("Error: unknown SPLASH_PLACEMENT policy %s.\n", Policy);
+		exit(-1);
+	}
+	if (Huge == NULL || *Huge == 0 || strcmp(Huge, "none") == 0) {
+		SplashHugeShift = 0;
+	} else if (strcmp(Huge, "thp") == 0) {
+		SplashHugeThp = 1;
+	} else if (strcmp(Huge, "2M") == 0) {
+		SplashHugeShift = 21;
+	} else if (strcmp(Huge, "1G") == 0) {
+		SplashHugeShift = 30;
+	} else {
+		printf("Error: SPLASH_HUGEPAGES must be none, thp, 2M or 1G.\n");
+		exit(-1);
+	}
+
+	File = fopen("/sys/devices/system/node/has_memory", "r");
+	if (File != NULL) {
+		if (fgets(Line, sizeof(Line), File) != NULL) {
+			SplashMemNodeCount = SplashParseCpuList(Line, SplashMemNodes, SPLASH_MAX_NODES);
+		}
+		fclose(File);
+	}
+	if (SplashMemNodeCount <= 0) {
+		SplashMemNodes[0] = 0;
+		SplashMemNodeCount = 1;
+	}
+	if (SplashCpuCount < 0) {
+		SplashAffinityInit();
+	}
+	SplashReadCpuNodes();
+}
+
+/* Node of the CPU process Id is bound to, or -1 without affinity. */
+long SplashProcessNode(long Id)
+{
+	if (SplashCpuCount < 0) {
+		SplashAffinityInit();
+	}
+	if (SplashCpuCount <= 0) {
+		return -1;
+	}
+	SplashReadCpuNodes();
+	return SplashCpuNode[SplashCpuOrder[Id % SplashCpuCount]];
+}
+
+/* Node that memory owned by process Owner should live on. */
+static long SplashOwnerNode(long Owner)
+{
+	unsigned int	Cpu, Node;
+
+	if (SplashCpuCount > 0) {
+		return SplashProcessNode(Owner);
+	}
+	if (Owner == SplashThreadId &&
+	    syscall(SYS_getcpu, &Cpu, &Node, NULL) == 0) {
+		return (long) Node;
+	}
+	return SplashMemNodes[Owner % SplashMemNodeCount];
+}
+
+static void SplashBind(char *Start, size_t Length, long Mode, long Node, unsigned long Flags)
+{
+	unsigned long	Mask[SPLASH_MAX_NODES / (8 * sizeof(unsigned long))];
+	long		i;
+
+	memset(Mask, 0, sizeof(Mask));
+	if (Node >= 0) {
+		Mask[Node / (8 * sizeof(unsigned long))] |= 1ul << (Node % (8 * sizeof(unsigned long)));
+	} else {
+		for (i = 0; i < SplashMemNodeCount; i++) {
+			Node = SplashMemNodes[i];
+			Mask[Node / (8 * sizeof(unsigned long))] |= 1ul << (Node % (8 * sizeof(unsigned long)));
+		}
+	}
+	/* A failed mbind only costs locality, so it is not fatal. */
+	syscall(SYS_mbind, Start, Length, Mode, Mask, SPLASH_MAX_NODES, Flags);
+}
+
+void *SplashMalloc(size_t Size, long Home)
+{
+	size_t		PageSize, Length;
+	char		*Base;
+	long		k, Flags;
+	SplashRegion	*Region;
+
+	pthread_once(&SplashPlaceOnce, SplashPlaceInit);
+	if ((SplashPlacement == SPLASH_PLACE_NONE && SplashHugeShift == 0 && !SplashHugeThp) ||
+	    Size < SPLASH_PLACE_MIN) {
+		return malloc(Size);
+	}
+
+	Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	PageSize = (size_t) sysconf(_SC_PAGESIZE);
+	Base = MAP_FAILED;
+	if (SplashHugeShift != 0) {
+		PageSize = (size_t) 1 << SplashHugeShift;
+		Length = (Size + PageSize - 1) & ~(PageSize - 1);
+		Base = mmap(NULL, Length, PROT_READ | PROT_WRITE,
+			    Flags | MAP_HUGETLB | (SplashHugeShift << MAP_HUGE_SHIFT), -1, 0);
+		if (Base == MAP_FAILED) {
+			PageSize = (size_t) sysconf(_SC_PAGESIZE);
+		}
+	}
+	if (Base == MAP_FAILED) {
+		Length = (Size + PageSize - 1) & ~(PageSize - 1);
+		Base = mmap(NULL, Length, PROT_READ | PROT_WRITE, Flags, -1, 0);
+		if (Base == MAP_FAILED) {
+			return malloc(Size);
+		}
+		if (SplashHugeThp || SplashHugeShift != 0) {
+			syscall(SYS_madvise, Base, Length, MADV_HUGEPAGE);
+		}
+	}
+
+	if (Home >= 0 && SplashPlacement != SPLASH_PLACE_INTERLEAVE &&
+	    SplashPlacement != SPLASH_PLACE_NONE) {
+		SplashBind(Base, Length, MPOL_PREFERRED, SplashOwnerNode(Home), 0);
+	} else if (SplashPlacement == SPLASH_PLACE_INTERLEAVE) {
+		SplashBind(Base, Length, MPOL_INTERLEAVE, -1, 0);
+	} else if (SplashPlacement == SPLASH_PLACE_STRIPE) {
+		size_t	Pages = Length / PageSize, First, Last;
+
+		for (k = 0; k < SplashMemNodeCount; k++) {
+			First = Pages * k / SplashMemNodeCount;
+			Last = Pages * (k + 1) / SplashMemNodeCount;
+			if (Last > First) {
+				SplashBind(Base + First * PageSize, (Last - First) * PageSize,
+					   MPOL_PREFERRED, SplashMemNodes[k], 0);
+			}
+		}
+	}
+
+	pthread_mutex_lock(&SplashRegionLock);
+	if (SplashRegionCount == SplashRegionMax) {
+		SplashRegionMax = (SplashRegionMax == 0) ? 64 : 2 * SplashRegionMax;
+		SplashRegions = (SplashRegion *) realloc(SplashRegions,
+							 SplashRegionMax * sizeof(SplashRegion));
+		if (SplashRegions == NULL) {
+			printf("Error while allocating the region table.\n");
+			exit(-1);
+		}
+	}
+	Region = &SplashRegions[SplashRegionCount++];
+	Region->Base = Base;
+	Region->Length = Length;
+	Region->PageSize = PageSize;
+	pthread_mutex_unlock(&SplashRegionLock);
+	return Base;
+}
+
+/* Region holding Ptr, or -1; the caller holds SplashRegionLock. */
+static long SplashFindRegion(char *Ptr)
+{
+	long	i;
+
+	for (i = 0; i < SplashRegionCount; i++) {
+		if (Ptr >= SplashRegions[i].Base &&
+		    Ptr < SplashRegions[i].Base + SplashRegions[i].Length) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void SplashFree(void *Ptr)
+{
+	long	i;
+
+	if (Ptr == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&SplashRegionLock);
+	i = SplashFindRegion((char *) Ptr);
+	if (i >= 0) {
+		munmap(SplashRegions[i].Base, SplashRegions[i].Length);
+		SplashRegions[i] = SplashRegions[--SplashRegionCount];
+	}
+	pthread_mutex_unlock(&SplashRegionLock);
+	if (i < 0) {
+		free(Ptr);
+	}
+}
+
+/* Move the whole pages of [Start, Start+Size) to the node of Owner. */
+void SplashPlace(void *Start, size_t Size, long Owner)
+{
+	SplashRegion	Region;
+	char		*First, *Last;
+	long		i;
+
+	pthread_once(&SplashPlaceOnce, SplashPlaceInit);
+	if (SplashPlacement != SPLASH_PLACE_OWNER && SplashPlacement != SPLASH_PLACE_STRIPE) {
+		return;
+	}
+	pthread_mutex_lock(&SplashRegionLock);
+	i = SplashFindRegion((char *) Start);
+	if (i >= 0) {
+		Region = SplashRegions[i];
+	}
+	pthread_mutex_unlock(&SplashRegionLock);
+	if (i < 0) {
+		return;
+	}
+
+	First = Region.Base + (((char *) Start - Region.Base + Region.PageSize - 1) &
+			       ~(Region.PageSize - 1));
+	Last = (char *) Start + Size;
+	if (Last > Region.Base + Region.Length) {
+		Last = Region.Base + Region.Length;
+	}
+	Last = Region.Base + ((Last - Region.Base) & ~(Region.PageSize - 1));
+	if (Last > First) {
+		SplashBind(First, Last - First, MPOL_PREFERRED, SplashOwnerNode(Owner), MPOL_MF_MOVE);
+	}
+}
+SPLASH_EXTRA_DEFS
+')
+
+define(MAIN_ENV, `SPLASH_ENV_DECLS
+SPLASH_ENV_DEFS
+')
+
+define(ENV, ` ')
+
+define(G_PLACE, `{SplashPlace((void *)($1), ($2), ($3));}')
+define(PROCESS_NODE, `SplashProcessNode($1)')
+define(LLC_SIZE, `SplashLLCSize($1)')
+
+define(CLOCK, `{($1) = (unsigned long)(SplashClockNs() / 1000);}')
+define(NS_CLOCK, `{($1) = SplashClockNs();}')
+define(PHASE_BEGIN, `{if (SplashStatsOn) SplashPhaseBegin($1);}')
+define(PHASE_END, `{if (SplashStatsOn) SplashPhaseEnd($1);}')
+define(SPLASH_WAIT_BEGIN, `if (SplashStatsOn) SplashWaitBegin();')
+define(SPLASH_WAIT_END, `if (SplashStatsOn) SplashWaitEnd();')
+
+define(EXTERN_ENV, `SPLASH_ENV_DECLS
+')